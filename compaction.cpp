@@ -1,10 +1,17 @@
 #include "db_engine.h"
 #include <map>
+#include <algorithm>
 #include <iostream>
 
 namespace db {
 
-    CompactionManager::CompactionManager(SSTable* sstable) : sstable_(sstable) {}
+    static bool is_compacted_file(const std::string& file) {
+        return std::filesystem::path(file).filename().string().rfind("compacted_", 0) == 0;
+    }
+
+    CompactionManager::CompactionManager(SSTable* sstable, size_t file_count_threshold)
+        : sstable_(sstable), file_count_threshold_(file_count_threshold) {
+    }
 
     CompactionManager::~CompactionManager() = default;
 
@@ -13,10 +20,28 @@ namespace db {
         return files.size() >= file_count_threshold_;
     }
 
-    void CompactionManager::compact() {
-        if (!needs_compaction()) return;
+    void CompactionManager::get_backlog(size_t& file_count, uint64_t& pending_bytes) const {
+        auto files = sstable_->list_files();
+        file_count = files.size();
+        pending_bytes = 0;
+
+        if (file_count < file_count_threshold_) return;
 
+        // Only flush output is waiting; the compacted base has already been merged.
+        for (const auto& file : files) {
+            if (is_compacted_file(file)) continue;
+
+            std::error_code ec;
+            auto size = std::filesystem::file_size(file, ec);
+            if (!ec) pending_bytes += size;
+        }
+    }
+
+    void CompactionManager::compact(bool force) {
         auto files = sstable_->list_files();
+        if (files.size() < 2) return;
+        if (!force && files.size() < file_count_threshold_) return;
+
         std::sort(files.begin(), files.end());
 
         std::vector<std::string> files_to_merge;
@@ -24,6 +49,9 @@ namespace db {
             files_to_merge.push_back(files[i]);
         }
 
+        // Rewriting a lone compacted file would not change anything.
+        if (files_to_merge.size() == 1 && is_compacted_file(files_to_merge[0])) return;
+
         merge_files(files_to_merge);
     }
 
@@ -77,29 +105,50 @@ namespace db {
         std::string new_file = sstable_->get_path() + "/compacted_" +
             std::to_string(std::chrono::system_clock::now().time_since_epoch().count()) +
             ".dat";
+        std::string temp_file = new_file + ".tmp";
+
+        std::ofstream outfile(temp_file, std::ios::binary);
+        if (!outfile.is_open()) return;
+
+        uint64_t count = records.size();
+        outfile.write(reinterpret_cast<const char*>(&count), sizeof(count));
 
-        std::ofstream outfile(new_file, std::ios::binary);
-        if (outfile.is_open()) {
-            uint64_t count = records.size();
-            outfile.write(reinterpret_cast<const char*>(&count), sizeof(count));
-
-            for (const auto& rec : records) {
-                uint32_t key_len = static_cast<uint32_t>(rec.key.size());
-                uint32_t val_len = static_cast<uint32_t>(rec.value.size());
-                uint8_t deleted = 0;
-
-                outfile.write(reinterpret_cast<const char*>(&key_len), sizeof(key_len));
-                outfile.write(rec.key.data(), key_len);
-                outfile.write(reinterpret_cast<const char*>(&val_len), sizeof(val_len));
-                outfile.write(rec.value.data(), val_len);
-                outfile.write(reinterpret_cast<const char*>(&deleted), sizeof(deleted));
-                outfile.write(reinterpret_cast<const char*>(&rec.timestamp), sizeof(rec.timestamp));
+        uint64_t pending_bytes = sizeof(count);
+
+        for (const auto& rec : records) {
+            uint32_t key_len = static_cast<uint32_t>(rec.key.size());
+            uint32_t val_len = static_cast<uint32_t>(rec.value.size());
+            uint8_t deleted = 0;
+
+            if (rate_limiter_) {
+                pending_bytes += sizeof(key_len) + key_len + sizeof(val_len) + val_len +
+                    sizeof(deleted) + sizeof(rec.timestamp);
+                if (pending_bytes >= RateLimiter::kChunkBytes) {
+                    rate_limiter_->request(pending_bytes, IOPriority::kLow);
+                    pending_bytes = 0;
+                }
             }
+
+            outfile.write(reinterpret_cast<const char*>(&key_len), sizeof(key_len));
+            outfile.write(rec.key.data(), key_len);
+            outfile.write(reinterpret_cast<const char*>(&val_len), sizeof(val_len));
+            outfile.write(rec.value.data(), val_len);
+            outfile.write(reinterpret_cast<const char*>(&deleted), sizeof(deleted));
+            outfile.write(reinterpret_cast<const char*>(&rec.timestamp), sizeof(rec.timestamp));
         }
 
-        for (const auto& file : files) {
-            std::filesystem::remove(file);
+        if (rate_limiter_ && pending_bytes > 0) {
+            rate_limiter_->request(pending_bytes, IOPriority::kLow);
         }
+
+        outfile.close();
+        if (!outfile.good()) {
+            std::error_code ec;
+            std::filesystem::remove(temp_file, ec);
+            return;
+        }
+
+        sstable_->install_file(temp_file, new_file, files);
     }
 
 } // namespace db
\ No newline at end of file
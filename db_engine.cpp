@@ -1,16 +1,39 @@
 #include "db_engine.h"
 #include <chrono>
 #include <algorithm>
+#include <stdexcept>
+#include <iostream>
 
 namespace db {
 
-    DBEngine::DBEngine(const std::string& data_dir, size_t memtable_size)
-        : data_dir_(data_dir), memtable_size_(memtable_size) {
+    DBEngine::DBEngine(const std::string& data_dir, size_t memtable_size, const DBOptions& options)
+        : data_dir_(data_dir), memtable_size_(memtable_size), options_(options) {
+
+        // Below the compaction threshold nothing drains the backlog, so a
+        // slowdown there would only add latency.
+        if (options_.l0_slowdown_trigger <= options_.compaction_threshold) {
+            throw std::invalid_argument("l0_slowdown_trigger must be above compaction_threshold");
+        }
+        if (options_.l0_stop_trigger < options_.l0_slowdown_trigger ||
+            options_.pending_compaction_stop_bytes < options_.pending_compaction_slowdown_bytes) {
+            throw std::invalid_argument("write stop triggers must not be below slowdown triggers");
+        }
 
         memtable_ = std::make_unique<MemTable>(memtable_size);
         wal_ = std::make_unique<WAL>(data_dir + "/wal.log");
         sstable_ = std::make_unique<SSTable>(data_dir + "/sstables");
-        compaction_ = std::make_unique<CompactionManager>(sstable_.get());
+        compaction_ = std::make_unique<CompactionManager>(sstable_.get(), options_.compaction_threshold);
+        write_controller_ = std::make_unique<WriteController>(options_);
+
+        if (options_.rate_limit_bytes_per_sec > 0) {
+            rate_limiter_ = std::make_unique<RateLimiter>(options_.rate_limit_bytes_per_sec);
+            sstable_->set_rate_limiter(rate_limiter_.get());
+            compaction_->set_rate_limiter(rate_limiter_.get());
+        }
+
+        if (options_.row_cache_size > 0) {
+            row_cache_ = std::make_unique<RowCache>(options_.row_cache_size);
+        }
 
         std::unordered_map<std::string, Record> recovered;
         if (wal_->recover(recovered)) {
@@ -20,13 +43,26 @@ namespace db {
                 }
             }
         }
+
+        update_write_stall();
+        compaction_thread_ = std::thread(&DBEngine::compaction_loop, this);
+        schedule_compaction();
     }
 
     DBEngine::~DBEngine() {
         flush();
+
+        {
+            std::lock_guard<std::mutex> lock(bg_mutex_);
+            shutting_down_ = true;
+        }
+        bg_cv_.notify_one();
+        compaction_thread_.join();
     }
 
     bool DBEngine::put(const std::string& key, const std::string& value) {
+        delay_write();
+
         Record rec(key, value);
         rec.timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(
             std::chrono::system_clock::now().time_since_epoch()
@@ -40,6 +76,10 @@ namespace db {
             return false;
         }
 
+        if (row_cache_) {
+            row_cache_->erase(key);
+        }
+
         if (memtable_->size() >= memtable_size_) {
             flush();
         }
@@ -48,11 +88,27 @@ namespace db {
     }
 
     bool DBEngine::get(const std::string& key, std::string& value) {
-        if (memtable_->get(key, value)) {
-            return true;
+        // Taken before the MemTable probe so a put landing after the probe
+        // still invalidates whatever this read is about to cache.
+        uint64_t version = row_cache_ ? row_cache_->version(key) : 0;
+
+        bool found = false;
+        if (memtable_->lookup(key, value, found)) {
+            return found;
         }
 
-        return sstable_->read(key, value);
+        if (!row_cache_) {
+            return sstable_->read(key, value);
+        }
+
+        if (row_cache_->lookup(key, value, found)) {
+            return found;
+        }
+
+        found = sstable_->read(key, value);
+        row_cache_->insert(key, found ? value : std::string(), found, version);
+
+        return found;
     }
 
     bool DBEngine::del(const std::string& key) {
@@ -67,7 +123,15 @@ namespace db {
             return false;
         }
 
-        return memtable_->del(key);
+        if (!memtable_->del(key)) {
+            return false;
+        }
+
+        if (row_cache_) {
+            row_cache_->erase(key);
+        }
+
+        return true;
     }
 
     void DBEngine::flush() {
@@ -77,13 +141,96 @@ namespace db {
         sstable_->write(records);
         wal_->clear();
 
-        if (compaction_->needs_compaction()) {
-            compact();
+        if (row_cache_) {
+            for (const auto& rec : records) {
+                row_cache_->erase(rec.key);
+            }
         }
+
+        update_write_stall();
+        schedule_compaction();
     }
 
     void DBEngine::compact() {
-        compaction_->compact();
+        run_compaction(false);
+    }
+
+    RowCache::Stats DBEngine::row_cache_stats() const {
+        return row_cache_ ? row_cache_->get_stats() : RowCache::Stats();
+    }
+
+    uint64_t DBEngine::write_delay_micros() const {
+        return write_controller_->delay_micros();
+    }
+
+    void DBEngine::delay_write() {
+        // Past the stop triggers, drain the backlog inline rather than
+        // waiting for the background thread to catch up.
+        if (write_controller_->stopped()) {
+            run_compaction(true);
+        }
+
+        uint64_t delay = write_controller_->delay_micros();
+        if (delay > 0) {
+            std::this_thread::sleep_for(std::chrono::microseconds(delay));
+        }
+    }
+
+    void DBEngine::update_write_stall() {
+        // Sample and publish together so a stale sample from one thread
+        // cannot overwrite a fresher one from another.
+        std::lock_guard<std::mutex> lock(stall_mutex_);
+
+        size_t file_count = 0;
+        uint64_t pending_bytes = 0;
+        compaction_->get_backlog(file_count, pending_bytes);
+        write_controller_->update(file_count, pending_bytes);
+    }
+
+    void DBEngine::schedule_compaction() {
+        if (options_.disable_auto_compaction) return;
+
+        {
+            std::lock_guard<std::mutex> lock(bg_mutex_);
+            compaction_scheduled_ = true;
+        }
+        bg_cv_.notify_one();
+    }
+
+    void DBEngine::run_compaction(bool force) {
+        {
+            std::lock_guard<std::mutex> lock(compaction_mutex_);
+
+            // Writers that queued up behind another compaction at the stop
+            // trigger may find the stall already cleared.
+            if (force) {
+                update_write_stall();
+                if (!write_controller_->stopped()) return;
+            }
+
+            compaction_->compact(force);
+        }
+        update_write_stall();
+    }
+
+    void DBEngine::compaction_loop() {
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(bg_mutex_);
+                bg_cv_.wait(lock, [this] { return compaction_scheduled_ || shutting_down_; });
+                if (shutting_down_) return;
+                compaction_scheduled_ = false;
+            }
+
+            // An exception escaping this thread would terminate the process;
+            // the next flush schedules another attempt.
+            try {
+                run_compaction(false);
+            }
+            catch (const std::exception& e) {
+                std::cerr << "Background compaction failed: " << e.what() << std::endl;
+            }
+        }
     }
 
 } // namespace db
\ No newline at end of file
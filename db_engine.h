@@ -4,10 +4,17 @@
 #include <string>
 #include <unordered_map>
 #include <vector>
+#include <list>
+#include <array>
 #include <memory>
 #include <mutex>
+#include <shared_mutex>
+#include <thread>
 #include <fstream>
 #include <filesystem>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 
 namespace db {
 
@@ -23,6 +30,124 @@ namespace db {
         }
     };
 
+    struct DBOptions {
+        // Bytes per second allowed for flush and compaction writes; 0 disables the limiter.
+        uint64_t rate_limit_bytes_per_sec = 0;
+
+        // SSTable count at which the background thread starts a compaction.
+        size_t compaction_threshold = 4;
+        // Leaves compaction to compact() calls and the write stop trigger.
+        bool disable_auto_compaction = false;
+
+        // Writers are delayed progressively between the slowdown and stop triggers.
+        // l0_slowdown_trigger must be above compaction_threshold. The byte triggers
+        // count flush output not yet merged into the compacted base file.
+        size_t l0_slowdown_trigger = 20;
+        size_t l0_stop_trigger = 36;
+        uint64_t pending_compaction_slowdown_bytes = 64ull * 1024 * 1024;
+        uint64_t pending_compaction_stop_bytes = 256ull * 1024 * 1024;
+        uint64_t max_write_delay_micros = 1000;
+
+        // Bytes (key + value) of resolved SSTable lookups kept in the row cache; 0 disables it.
+        size_t row_cache_size = 0;
+    };
+
+    enum class IOPriority {
+        kLow,   // compaction
+        kHigh   // flush
+    };
+
+    class RateLimiter {
+    public:
+        static constexpr size_t kChunkBytes = 64 * 1024;
+
+        explicit RateLimiter(uint64_t bytes_per_sec, uint64_t refill_period_us = 100000);
+        ~RateLimiter();
+
+        void request(uint64_t bytes, IOPriority priority);
+
+    private:
+        uint64_t bytes_per_sec_;
+        uint64_t refill_period_us_;
+        uint64_t refill_bytes_;
+        uint64_t available_bytes_;
+        size_t high_waiters_ = 0;
+        std::chrono::steady_clock::time_point last_refill_;
+        std::mutex mutex_;
+        std::condition_variable cv_;
+
+        void refill();
+        void acquire(uint64_t bytes, IOPriority priority);
+    };
+
+    class WriteController {
+    public:
+        explicit WriteController(const DBOptions& options);
+        ~WriteController();
+
+        void update(size_t l0_files, uint64_t pending_compaction_bytes);
+        uint64_t delay_micros() const { return delay_micros_.load(); }
+        bool stopped() const { return stopped_.load(); }
+
+    private:
+        DBOptions options_;
+        std::atomic<uint64_t> delay_micros_{ 0 };
+        std::atomic<bool> stopped_{ false };
+
+        static double pressure(uint64_t value, uint64_t slowdown, uint64_t stop);
+    };
+
+    class RowCache {
+    public:
+        struct Stats {
+            uint64_t hits = 0;
+            uint64_t misses = 0;
+
+            double hit_rate() const {
+                uint64_t total = hits + misses;
+                return total ? static_cast<double>(hits) / total : 0.0;
+            }
+        };
+
+        explicit RowCache(size_t capacity);
+        ~RowCache();
+
+        // Returns true on a cache hit; `found` is false for a cached miss.
+        bool lookup(const std::string& key, std::string& value, bool& found);
+        // Dropped if `key` was erased since `version` was taken.
+        void insert(const std::string& key, const std::string& value, bool found, uint64_t version);
+        void erase(const std::string& key);
+
+        uint64_t version(const std::string& key) const;
+        Stats get_stats() const;
+
+    private:
+        struct Entry {
+            std::string value;
+            bool found;
+            bool is_protected;
+            size_t charge;
+            std::list<std::string>::iterator pos;
+        };
+
+        size_t capacity_;
+        size_t protected_capacity_;
+        size_t usage_ = 0;
+        size_t protected_usage_ = 0;
+        std::unordered_map<std::string, Entry> entries_;
+        std::list<std::string> probation_;
+        std::list<std::string> protected_;
+        std::atomic<size_t> entry_count_{ 0 };
+        std::array<std::atomic<uint64_t>, 1024> versions_{};
+        std::atomic<uint64_t> hits_{ 0 };
+        std::atomic<uint64_t> misses_{ 0 };
+        mutable std::mutex mutex_;
+
+        void evict();
+        std::atomic<uint64_t>& stripe(const std::string& key);
+        static size_t charge_of(const std::string& key, const std::string& value);
+    };
+
     class MemTable {
     public:
         MemTable(size_t max_size = 1024 * 1024);
@@ -30,6 +155,8 @@ namespace db {
 
         bool put(const std::string& key, const std::string& value);
         bool get(const std::string& key, std::string& value);
+        // Returns true if the key has an entry here; `found` is false for a tombstone.
+        bool lookup(const std::string& key, std::string& value, bool& found);
         bool del(const std::string& key);
         size_t size() const;
         bool empty() const;
@@ -72,31 +199,44 @@ namespace db {
         bool read(const std::string& key, std::string& value);
         std::vector<std::string> list_files();
         std::string get_path() const;
+        void set_rate_limiter(RateLimiter* limiter) { rate_limiter_ = limiter; }
+
+        // Renames a fully written temp file into place and drops the files it
+        // replaces, without letting a concurrent read see a partial state.
+        bool install_file(const std::string& temp_file, const std::string& final_file,
+            const std::vector<std::string>& obsolete_files);
 
     private:
         std::string directory_;
+        RateLimiter* rate_limiter_ = nullptr;
+        std::shared_mutex files_mutex_;
 
         std::string generate_filename();
     };
 
     class CompactionManager {
     public:
-        explicit CompactionManager(SSTable* sstable);
+        explicit CompactionManager(SSTable* sstable, size_t file_count_threshold = 4);
         ~CompactionManager();
 
-        void compact();
+        // With `force`, merges whenever there are at least two files.
+        void compact(bool force = false);
         bool needs_compaction() const;
+        void get_backlog(size_t& file_count, uint64_t& pending_bytes) const;
+        void set_rate_limiter(RateLimiter* limiter) { rate_limiter_ = limiter; }
 
     private:
         SSTable* sstable_;
-        size_t file_count_threshold_ = 4;
+        RateLimiter* rate_limiter_ = nullptr;
+        size_t file_count_threshold_;
 
         void merge_files(const std::vector<std::string>& files);
     };
 
     class DBEngine {
     public:
-        DBEngine(const std::string& data_dir, size_t memtable_size = 1024 * 1024);
+        DBEngine(const std::string& data_dir, size_t memtable_size = 1024 * 1024,
+            const DBOptions& options = DBOptions());
         ~DBEngine();
 
         bool put(const std::string& key, const std::string& value);
@@ -104,14 +244,34 @@ namespace db {
         bool del(const std::string& key);
         void flush();
         void compact();
+        RowCache::Stats row_cache_stats() const;
+        uint64_t write_delay_micros() const;
 
     private:
         std::string data_dir_;
         size_t memtable_size_;
+        DBOptions options_;
         std::unique_ptr<MemTable> memtable_;
         std::unique_ptr<WAL> wal_;
         std::unique_ptr<SSTable> sstable_;
         std::unique_ptr<CompactionManager> compaction_;
+        std::unique_ptr<RateLimiter> rate_limiter_;
+        std::unique_ptr<WriteController> write_controller_;
+        std::unique_ptr<RowCache> row_cache_;
+
+        std::thread compaction_thread_;
+        std::mutex compaction_mutex_;
+        std::mutex stall_mutex_;
+        std::mutex bg_mutex_;
+        std::condition_variable bg_cv_;
+        bool compaction_scheduled_ = false;
+        bool shutting_down_ = false;
+
+        void delay_write();
+        void update_write_stall();
+        void schedule_compaction();
+        void run_compaction(bool force);
+        void compaction_loop();
     };
 
 } // namespace db
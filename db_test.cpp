@@ -0,0 +1,299 @@
+// Standalone checks for the storage engine.
+// Build: g++ -std=c++17 -pthread db_test.cpp compaction.cpp db_engine.cpp memtable.cpp
+//        rate_limiter.cpp row_cache.cpp sstable.cpp wal.cpp write_controller.cpp -o db_test
+
+#include "db_engine.h"
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+static int failures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            std::cout << "  FAILED: " << #cond << " (line " << __LINE__ << ")" << std::endl; \
+            ++failures; \
+        } \
+    } while (0)
+
+static std::string fresh_dir(const std::string& name) {
+    std::string dir = "./test_data/" + name;
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+    return dir;
+}
+
+static void test_write_controller() {
+    std::cout << "write controller" << std::endl;
+
+    db::DBOptions options;
+    options.compaction_threshold = 2;
+    options.l0_slowdown_trigger = 4;
+    options.l0_stop_trigger = 8;
+    options.pending_compaction_slowdown_bytes = 1000;
+    options.pending_compaction_stop_bytes = 2000;
+    options.max_write_delay_micros = 1000;
+
+    db::WriteController controller(options);
+
+    controller.update(3, 0);
+    CHECK(controller.delay_micros() == 0);
+
+    controller.update(5, 0);
+    uint64_t low = controller.delay_micros();
+    controller.update(7, 0);
+    uint64_t high = controller.delay_micros();
+    CHECK(low > 0);
+    CHECK(high > low);
+    CHECK(!controller.stopped());
+
+    controller.update(8, 0);
+    CHECK(controller.stopped());
+    CHECK(controller.delay_micros() == options.max_write_delay_micros);
+
+    controller.update(3, 1500);
+    CHECK(controller.delay_micros() > 0);
+    CHECK(!controller.stopped());
+
+    controller.update(1, 0);
+    CHECK(controller.delay_micros() == 0);
+    CHECK(!controller.stopped());
+}
+
+static void test_rate_limiter() {
+    std::cout << "rate limiter" << std::endl;
+
+    const uint64_t rate = 1024 * 1024;
+    const uint64_t bytes = 512 * 1024;
+    db::RateLimiter limiter(rate);
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t sent = 0; sent < bytes; sent += db::RateLimiter::kChunkBytes) {
+        limiter.request(db::RateLimiter::kChunkBytes, db::IOPriority::kLow);
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // The bucket starts with one 100ms period of tokens. Finishing early means
+    // the accounting is wrong; the upper bound only guards against a stuck
+    // limiter, since a loaded machine can oversleep.
+    double expected = static_cast<double>(bytes) / rate - 0.1;
+    std::cout << "  " << bytes << " bytes in " << elapsed << "s (expected ~" << expected << "s)" << std::endl;
+    CHECK(elapsed > expected * 0.9);
+    CHECK(elapsed < expected + 5.0);
+}
+
+static void test_invalid_stall_options() {
+    std::cout << "invalid stall options" << std::endl;
+
+    db::DBOptions options;
+    options.compaction_threshold = 4;
+    options.l0_slowdown_trigger = 4;
+
+    bool rejected = false;
+    try {
+        db::DBEngine engine(fresh_dir("invalid"), 4096, options);
+    }
+    catch (const std::invalid_argument&) {
+        rejected = true;
+    }
+    CHECK(rejected);
+}
+
+static void test_write_stall() {
+    std::cout << "write stall" << std::endl;
+
+    // With auto compaction off, each flush adds exactly one file, so the
+    // stall level follows the file count deterministically.
+    db::DBOptions options;
+    options.disable_auto_compaction = true;
+    options.compaction_threshold = 2;
+    options.l0_slowdown_trigger = 3;
+    options.l0_stop_trigger = 6;
+    options.max_write_delay_micros = 1000;
+
+    std::string value(512, 'v');
+    int next_key = 0;
+
+    db::DBEngine engine(fresh_dir("stall"), 4096, options);
+
+    // Writes until the delay changes and returns the new value.
+    auto write_until_delay_changes = [&]() {
+        uint64_t before = engine.write_delay_micros();
+        for (int i = 0; i < 100 && engine.write_delay_micros() == before; ++i) {
+            engine.put("key" + std::to_string(next_key++), value);
+        }
+        return engine.write_delay_micros();
+    };
+
+    // Files 3, 4 and 5 slow writers down progressively; file 6 hits the stop trigger.
+    uint64_t previous = 0;
+    for (int step = 0; step < 3; ++step) {
+        uint64_t delay = write_until_delay_changes();
+        CHECK(delay > previous);
+        CHECK(delay < options.max_write_delay_micros);
+        previous = delay;
+    }
+    CHECK(write_until_delay_changes() == options.max_write_delay_micros);
+
+    // The next writer compacts inline instead of blocking, which clears the stall.
+    engine.put("key" + std::to_string(next_key++), value);
+    CHECK(engine.write_delay_micros() == 0);
+
+    // A manual compaction relieves a backlog as well.
+    CHECK(write_until_delay_changes() > 0);
+    engine.compact();
+    CHECK(engine.write_delay_micros() == 0);
+
+    int missing = 0;
+    std::string out;
+    for (int i = 0; i < next_key; ++i) {
+        if (!engine.get("key" + std::to_string(i), out) || out != value) ++missing;
+    }
+    CHECK(missing == 0);
+}
+
+static void test_background_compaction() {
+    std::cout << "background compaction" << std::endl;
+
+    db::DBOptions options;
+    options.rate_limit_bytes_per_sec = 256 * 1024;
+    options.compaction_threshold = 2;
+    options.l0_slowdown_trigger = 3;
+    options.l0_stop_trigger = 8;
+
+    const int num_keys = 200;
+    std::string value(512, 'v');
+
+    db::DBEngine engine(fresh_dir("background"), 4096, options);
+
+    for (int i = 0; i < num_keys; ++i) {
+        engine.put("key" + std::to_string(i), value);
+    }
+
+    // Once writes stop, the background thread drains whatever backlog is left.
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(60);
+    while (engine.write_delay_micros() > 0 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    CHECK(engine.write_delay_micros() == 0);
+
+    int missing = 0;
+    std::string out;
+    for (int i = 0; i < num_keys; ++i) {
+        if (!engine.get("key" + std::to_string(i), out) || out != value) ++missing;
+    }
+    CHECK(missing == 0);
+}
+
+static void test_row_cache_policy() {
+    std::cout << "row cache policy" << std::endl;
+
+    db::RowCache cache(2000);
+    std::string value(96, 'v');
+    std::string out;
+    bool found = false;
+
+    // A key hit twice is protected from a scan of one-off keys.
+    cache.insert("hot", value, true, cache.version("hot"));
+    CHECK(cache.lookup("hot", out, found));
+    for (int i = 0; i < 50; ++i) {
+        std::string key = "scan" + std::to_string(i);
+        cache.insert(key, value, true, cache.version(key));
+    }
+    CHECK(cache.lookup("hot", out, found) && found && out == value);
+    CHECK(!cache.lookup("scan0", out, found));
+
+    // Values larger than the whole cache are not cached at all.
+    cache.insert("big", std::string(2000, 'b'), true, cache.version("big"));
+    CHECK(!cache.lookup("big", out, found));
+
+    // Per-entry bookkeeping is charged too, so tiny negative entries cannot
+    // pile up far beyond the budget.
+    db::RowCache small(1000);
+    for (int i = 0; i < 100; ++i) {
+        std::string key = "n" + std::to_string(i);
+        small.insert(key, std::string(), false, small.version(key));
+    }
+    CHECK(!small.lookup("n0", out, found));
+    CHECK(small.lookup("n99", out, found) && !found);
+
+    // A fill that raced with a write to the same key is dropped...
+    uint64_t version = cache.version("raced");
+    cache.erase("raced");
+    cache.insert("raced", value, true, version);
+    CHECK(!cache.lookup("raced", out, found));
+
+    // ...but writes to other keys do not hold it back.
+    version = cache.version("kept");
+    cache.erase("unrelated");
+    cache.insert("kept", value, true, version);
+    CHECK(cache.lookup("kept", out, found) && found);
+}
+
+static void test_row_cache_invalidation() {
+    std::cout << "row cache invalidation" << std::endl;
+
+    db::DBOptions options;
+    options.row_cache_size = 64 * 1024;
+
+    db::DBEngine engine(fresh_dir("row_cache"), 1024 * 1024, options);
+    std::string out;
+
+    engine.put("a", "1");
+    engine.put("b", "2");
+    engine.flush();
+
+    CHECK(engine.get("a", out) && out == "1");
+    CHECK(engine.get("a", out) && out == "1");
+    CHECK(engine.row_cache_stats().hits == 1);
+
+    // Negative results are cached too.
+    CHECK(!engine.get("missing", out));
+    CHECK(!engine.get("missing", out));
+    CHECK(engine.row_cache_stats().hits == 2);
+
+    engine.put("a", "3");
+    CHECK(engine.get("a", out) && out == "3");
+    engine.flush();
+    CHECK(engine.get("a", out) && out == "3");
+    CHECK(engine.get("a", out) && out == "3");
+
+    engine.put("missing", "9");
+    CHECK(engine.get("missing", out) && out == "9");
+    engine.flush();
+    CHECK(engine.get("missing", out) && out == "9");
+
+    CHECK(engine.get("b", out) && out == "2");
+    CHECK(engine.get("b", out) && out == "2");
+    engine.del("b");
+    CHECK(!engine.get("b", out));
+    engine.flush();
+    CHECK(!engine.get("b", out));
+    CHECK(!engine.get("b", out));
+
+    auto stats = engine.row_cache_stats();
+    std::cout << "  " << stats.hits << " hits, " << stats.misses << " misses" << std::endl;
+}
+
+int main() {
+    test_write_controller();
+    test_rate_limiter();
+    test_invalid_stall_options();
+    test_write_stall();
+    test_background_compaction();
+    test_row_cache_policy();
+    test_row_cache_invalidation();
+
+    std::filesystem::remove_all("./test_data");
+
+    if (failures > 0) {
+        std::cout << failures << " check(s) failed" << std::endl;
+        return 1;
+    }
+
+    std::cout << "All checks passed" << std::endl;
+    return 0;
+}
\ No newline at end of file
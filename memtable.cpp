@@ -45,6 +45,22 @@ namespace db {
         return false;
     }
 
+    bool MemTable::lookup(const std::string& key, std::string& value, bool& found) {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        auto it = table_.find(key);
+        if (it == table_.end()) {
+            return false;
+        }
+
+        found = !it->second.deleted;
+        if (found) {
+            value = it->second.value;
+        }
+
+        return true;
+    }
+
     bool MemTable::del(const std::string& key) {
         std::lock_guard<std::mutex> lock(mutex_);
 
@@ -0,0 +1,82 @@
+#include "db_engine.h"
+#include <algorithm>
+
+namespace db {
+
+    RateLimiter::RateLimiter(uint64_t bytes_per_sec, uint64_t refill_period_us)
+        : bytes_per_sec_(std::max<uint64_t>(bytes_per_sec, 1)),
+        refill_period_us_(std::max<uint64_t>(refill_period_us, 1)),
+        last_refill_(std::chrono::steady_clock::now()) {
+
+        refill_bytes_ = std::max<uint64_t>(bytes_per_sec_ * refill_period_us_ / 1000000, 1);
+        available_bytes_ = refill_bytes_;
+    }
+
+    RateLimiter::~RateLimiter() = default;
+
+    void RateLimiter::refill() {
+        auto now = std::chrono::steady_clock::now();
+        uint64_t elapsed_us = static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::microseconds>(now - last_refill_).count()
+        );
+
+        // The bucket never holds more than one period's worth, so a longer
+        // idle stretch just fills it (and keeps the product below from overflowing).
+        if (elapsed_us >= refill_period_us_) {
+            available_bytes_ = refill_bytes_;
+            last_refill_ = now;
+            return;
+        }
+
+        uint64_t added = elapsed_us * bytes_per_sec_ / 1000000;
+        if (added == 0) return;
+
+        available_bytes_ = std::min(refill_bytes_, available_bytes_ + added);
+
+        if (available_bytes_ == refill_bytes_) {
+            last_refill_ = now;
+        }
+        else {
+            // Only consume the time that was turned into tokens so fractional
+            // bytes carry over to the next refill.
+            last_refill_ += std::chrono::microseconds(added * 1000000 / bytes_per_sec_);
+        }
+    }
+
+    void RateLimiter::request(uint64_t bytes, IOPriority priority) {
+        // Large requests are split so a single compaction cannot drain the
+        // bucket for longer than one refill period at a time.
+        while (bytes > 0) {
+            uint64_t chunk = std::min(bytes, refill_bytes_);
+            acquire(chunk, priority);
+            bytes -= chunk;
+        }
+    }
+
+    void RateLimiter::acquire(uint64_t bytes, IOPriority priority) {
+        std::unique_lock<std::mutex> lock(mutex_);
+
+        bool high = (priority == IOPriority::kHigh);
+        if (high) ++high_waiters_;
+
+        while (true) {
+            refill();
+
+            // Low priority callers yield to any flush waiting for tokens.
+            if (available_bytes_ >= bytes && (high || high_waiters_ == 0)) {
+                available_bytes_ -= bytes;
+                break;
+            }
+
+            uint64_t missing = bytes > available_bytes_ ? bytes - available_bytes_ : 1;
+            auto wait_us = std::max<uint64_t>(missing * 1000000 / bytes_per_sec_, 1);
+            cv_.wait_for(lock, std::chrono::microseconds(wait_us));
+        }
+
+        if (high) {
+            --high_waiters_;
+            cv_.notify_all();
+        }
+    }
+
+} // namespace db
\ No newline at end of file
@@ -0,0 +1,149 @@
+#include "db_engine.h"
+#include <algorithm>
+
+namespace db {
+
+    // Segmented LRU: new keys enter the probation segment and are promoted to
+    // the protected segment only when hit again, so one-off scans cannot push
+    // hot keys out of the cache. Capacity is in bytes, including per-entry
+    // bookkeeping.
+    RowCache::RowCache(size_t capacity)
+        : capacity_(std::max<size_t>(capacity, 1)),
+        protected_capacity_(capacity_ * 4 / 5) {
+    }
+
+    RowCache::~RowCache() = default;
+
+    std::atomic<uint64_t>& RowCache::stripe(const std::string& key) {
+        return versions_[std::hash<std::string>()(key) % versions_.size()];
+    }
+
+    uint64_t RowCache::version(const std::string& key) const {
+        return versions_[std::hash<std::string>()(key) % versions_.size()].load();
+    }
+
+    size_t RowCache::charge_of(const std::string& key, const std::string& value) {
+        // The key is stored in both the hash node and the LRU list node.
+        constexpr size_t kHashNodeOverhead = sizeof(std::string) + sizeof(Entry) + 3 * sizeof(void*);
+        constexpr size_t kListNodeOverhead = sizeof(std::string) + 2 * sizeof(void*);
+
+        return kHashNodeOverhead + kListNodeOverhead + 2 * key.size() + value.size();
+    }
+
+    bool RowCache::lookup(const std::string& key, std::string& value, bool& found) {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        auto it = entries_.find(key);
+        if (it == entries_.end()) {
+            ++misses_;
+            return false;
+        }
+
+        Entry& entry = it->second;
+        if (entry.is_protected) {
+            protected_.splice(protected_.begin(), protected_, entry.pos);
+        }
+        else {
+            protected_.splice(protected_.begin(), probation_, entry.pos);
+            entry.is_protected = true;
+            protected_usage_ += entry.charge;
+
+            while (protected_usage_ > protected_capacity_) {
+                auto& demoted = entries_[protected_.back()];
+                probation_.splice(probation_.begin(), protected_, demoted.pos);
+                demoted.is_protected = false;
+                protected_usage_ -= demoted.charge;
+            }
+        }
+
+        ++hits_;
+        found = entry.found;
+        if (found) {
+            value = entry.value;
+        }
+
+        return true;
+    }
+
+    void RowCache::insert(const std::string& key, const std::string& value, bool found,
+        uint64_t version) {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        size_t charge = charge_of(key, value);
+        if (charge > capacity_ || entries_.count(key)) return;
+
+        // Announce the insert before checking the version, so a concurrent
+        // erase either bumps the version first (and this backs off) or sees
+        // a non-zero count and waits on the mutex to remove the entry.
+        entry_count_ = entries_.size() + 1;
+
+        // A write to this key (or one sharing its stripe) landed while the
+        // caller was reading SSTables; its result may be stale.
+        if (version != stripe(key).load()) {
+            entry_count_ = entries_.size();
+            return;
+        }
+
+        probation_.push_front(key);
+
+        Entry entry;
+        entry.value = value;
+        entry.found = found;
+        entry.is_protected = false;
+        entry.charge = charge;
+        entry.pos = probation_.begin();
+        entries_[key] = std::move(entry);
+        entry_count_ = entries_.size();
+        usage_ += charge;
+
+        evict();
+    }
+
+    void RowCache::erase(const std::string& key) {
+        // Skips the mutex entirely while the cache is empty; see insert().
+        ++stripe(key);
+        if (entry_count_.load() == 0) return;
+
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        auto it = entries_.find(key);
+        if (it == entries_.end()) return;
+
+        usage_ -= it->second.charge;
+        if (it->second.is_protected) {
+            protected_usage_ -= it->second.charge;
+            protected_.erase(it->second.pos);
+        }
+        else {
+            probation_.erase(it->second.pos);
+        }
+        entries_.erase(it);
+        entry_count_ = entries_.size();
+    }
+
+    RowCache::Stats RowCache::get_stats() const {
+        Stats stats;
+        stats.hits = hits_.load();
+        stats.misses = misses_.load();
+        return stats;
+    }
+
+    void RowCache::evict() {
+        while (usage_ > capacity_) {
+            bool from_protected = probation_.empty();
+            auto& segment = from_protected ? protected_ : probation_;
+
+            auto it = entries_.find(segment.back());
+            usage_ -= it->second.charge;
+            if (from_protected) {
+                protected_usage_ -= it->second.charge;
+            }
+
+            entries_.erase(it);
+            segment.pop_back();
+        }
+
+        entry_count_ = entries_.size();
+    }
+
+} // namespace db
\ No newline at end of file
@@ -16,25 +16,43 @@ namespace db {
             now.time_since_epoch()
         ).count();
 
-        return directory_ + "/sstable_" + std::to_string(timestamp) + ".dat";
+        // Flushes within the same millisecond must not overwrite each other.
+        std::string filename;
+        do {
+            filename = directory_ + "/sstable_" + std::to_string(timestamp++) + ".dat";
+        } while (std::filesystem::exists(filename));
+
+        return filename;
     }
 
     bool SSTable::write(const std::vector<Record>& records) {
         if (records.empty()) return true;
 
         std::string filename = generate_filename();
-        std::ofstream file(filename, std::ios::binary);
+        std::string temp_filename = filename + ".tmp";
+        std::ofstream file(temp_filename, std::ios::binary);
 
         if (!file.is_open()) return false;
 
         uint64_t count = records.size();
         file.write(reinterpret_cast<const char*>(&count), sizeof(count));
 
+        uint64_t pending_bytes = sizeof(count);
+
         for (const auto& rec : records) {
             uint32_t key_len = static_cast<uint32_t>(rec.key.size());
             uint32_t val_len = static_cast<uint32_t>(rec.value.size());
             uint8_t deleted = rec.deleted ? 1 : 0;
 
+            if (rate_limiter_) {
+                pending_bytes += sizeof(key_len) + key_len + sizeof(val_len) + val_len +
+                    sizeof(deleted) + sizeof(rec.timestamp);
+                if (pending_bytes >= RateLimiter::kChunkBytes) {
+                    rate_limiter_->request(pending_bytes, IOPriority::kHigh);
+                    pending_bytes = 0;
+                }
+            }
+
             file.write(reinterpret_cast<const char*>(&key_len), sizeof(key_len));
             file.write(rec.key.data(), key_len);
             file.write(reinterpret_cast<const char*>(&val_len), sizeof(val_len));
@@ -43,10 +61,41 @@ namespace db {
             file.write(reinterpret_cast<const char*>(&rec.timestamp), sizeof(rec.timestamp));
         }
 
-        return file.good();
+        if (rate_limiter_ && pending_bytes > 0) {
+            rate_limiter_->request(pending_bytes, IOPriority::kHigh);
+        }
+
+        file.close();
+        if (!file.good()) {
+            std::error_code ec;
+            std::filesystem::remove(temp_filename, ec);
+            return false;
+        }
+
+        return install_file(temp_filename, filename, {});
+    }
+
+    bool SSTable::install_file(const std::string& temp_file, const std::string& final_file,
+        const std::vector<std::string>& obsolete_files) {
+        std::unique_lock<std::shared_mutex> lock(files_mutex_);
+
+        std::error_code ec;
+        std::filesystem::rename(temp_file, final_file, ec);
+        if (ec) {
+            std::filesystem::remove(temp_file, ec);
+            return false;
+        }
+
+        for (const auto& file : obsolete_files) {
+            std::filesystem::remove(file, ec);
+        }
+
+        return true;
     }
 
     bool SSTable::read(const std::string& key, std::string& value) {
+        std::shared_lock<std::shared_mutex> lock(files_mutex_);
+
         auto files = list_files();
         std::sort(files.begin(), files.end(), std::greater<std::string>());
 
@@ -98,9 +147,11 @@ namespace db {
     std::vector<std::string> SSTable::list_files() {
         std::vector<std::string> files;
 
-        for (const auto& entry : std::filesystem::directory_iterator(directory_)) {
-            if (entry.path().extension() == ".dat") {
-                files.push_back(entry.path().string());
+        // Also called from the compaction thread, so errors must not throw.
+        std::error_code ec;
+        for (std::filesystem::directory_iterator it(directory_, ec), end; !ec && it != end; it.increment(ec)) {
+            if (it->path().extension() == ".dat") {
+                files.push_back(it->path().string());
             }
         }
 
@@ -0,0 +1,30 @@
+#include "db_engine.h"
+#include <algorithm>
+
+namespace db {
+
+    WriteController::WriteController(const DBOptions& options) : options_(options) {}
+
+    WriteController::~WriteController() = default;
+
+    double WriteController::pressure(uint64_t value, uint64_t slowdown, uint64_t stop) {
+        if (value < slowdown) return 0.0;
+        if (value >= stop) return 1.0;
+
+        return static_cast<double>(value - slowdown + 1) /
+            static_cast<double>(stop - slowdown + 1);
+    }
+
+    void WriteController::update(size_t l0_files, uint64_t pending_compaction_bytes) {
+        double files_pressure = pressure(l0_files,
+            options_.l0_slowdown_trigger, options_.l0_stop_trigger);
+        double bytes_pressure = pressure(pending_compaction_bytes,
+            options_.pending_compaction_slowdown_bytes, options_.pending_compaction_stop_bytes);
+
+        double level = std::max(files_pressure, bytes_pressure);
+
+        delay_micros_ = static_cast<uint64_t>(level * options_.max_write_delay_micros);
+        stopped_ = (level >= 1.0);
+    }
+
+} // namespace db
\ No newline at end of file